@@ -0,0 +1,257 @@
+/*
+  mi-cpptest
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: diana@met.no
+
+  This file is part of mi-cpptest.
+
+  mi-cpptest is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  mi-cpptest is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with mi-cpptest; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// Measures the cost of the library's own hot paths. Results are printed
+// as one JSON object per line ("JSON lines") on stdout.
+
+#include "mi_cpptest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// stream buffer discarding everything written to it
+class null_buffer : public std::streambuf {
+protected:
+  int overflow(int c) override { return traits_type::not_eof(c); }
+  std::streamsize xsputn(const char *, std::streamsize n) override { return n; }
+};
+
+// read through volatile so that the compiler cannot fold the checks
+volatile int int_value = 42;
+volatile double double_value = 1.0;
+
+typedef void (*bench_function_t)(size_t);
+
+struct bench {
+  const char *name;
+  size_t iterations;
+  bench_function_t function;
+  bench_function_t prepare; //!< called before timing, may be null
+};
+
+void check_eq_pass(size_t n) {
+  miutil::cpptest::test_recorder tr;
+  miutil::cpptest::test_recorder *mi_cpptest_recorder = &tr;
+  for (size_t i = 0; i < n; ++i) {
+    const int a = int_value;
+    MI_CPPTEST_CHECK_EQ(a, int_value);
+  }
+}
+
+// failing checks use a new recorder for each batch, so that the growth of
+// the message list does not dominate
+const size_t FAIL_BATCH = 1000;
+
+void check_eq_fail(size_t n) {
+  for (size_t b = 0; b < n; b += FAIL_BATCH) {
+    miutil::cpptest::test_recorder tr;
+    miutil::cpptest::test_recorder *mi_cpptest_recorder = &tr;
+    for (size_t i = b; i < n && i < b + FAIL_BATCH; ++i) {
+      const int a = int_value + 1;
+      MI_CPPTEST_CHECK_EQ(a, int_value);
+    }
+  }
+}
+
+void check_close_pass(size_t n) {
+  miutil::cpptest::test_recorder tr;
+  miutil::cpptest::test_recorder *mi_cpptest_recorder = &tr;
+  for (size_t i = 0; i < n; ++i) {
+    const double a = double_value * (1 + 1e-9);
+    MI_CPPTEST_CHECK_CLOSE(a, double_value, 1e-6);
+  }
+}
+
+void check_close_fail(size_t n) {
+  for (size_t b = 0; b < n; b += FAIL_BATCH) {
+    miutil::cpptest::test_recorder tr;
+    miutil::cpptest::test_recorder *mi_cpptest_recorder = &tr;
+    for (size_t i = b; i < n && i < b + FAIL_BATCH; ++i) {
+      const double a = double_value * 1.1;
+      MI_CPPTEST_CHECK_CLOSE(a, double_value, 1e-6);
+    }
+  }
+}
+
+template <class T> void stringify_n(const T &value, size_t n) {
+  null_buffer nb;
+  std::ostream out(&nb);
+  for (size_t i = 0; i < n; ++i)
+    out << miutil::cpptest::stringify(value);
+}
+
+void stringify_int(size_t n) { stringify_n(int_value, n); }
+
+void stringify_double(size_t n) { stringify_n(double_value / 3, n); }
+
+void stringify_vector_double(size_t n) {
+  std::vector<double> v;
+  for (int i = 0; i < 100; ++i)
+    v.push_back(double_value / (i + 3));
+  stringify_n(v, n);
+}
+
+void stringify_map_int_string(size_t n) {
+  std::map<int, std::string> m;
+  for (int i = 0; i < 100; ++i)
+    m[i] = "value";
+  stringify_n(m, n);
+}
+
+void stringify_pair(size_t n) {
+  stringify_n(std::make_pair(int_value, double_value), n);
+}
+
+void recorder_record(size_t n) {
+  for (size_t b = 0; b < n; b += FAIL_BATCH) {
+    miutil::cpptest::test_recorder tr;
+    for (size_t i = b; i < n && i < b + FAIL_BATCH; ++i)
+      tr.record(__FILE__, __LINE__, "message");
+  }
+}
+
+void empty_test(miutil::cpptest::test_recorder *) {}
+
+std::vector<std::string> registered_names;
+size_t n_registered = 0;
+
+void prepare_names(size_t n) {
+  registered_names.reserve(n);
+  for (size_t i = registered_names.size(); i < n; ++i)
+    registered_names.push_back("bench_test_" + std::to_string(i));
+}
+
+// tests cannot be unregistered, so registry_register must be run first
+void registry_register(size_t n) {
+  for (size_t i = n_registered; i < n; ++i)
+    miutil::cpptest::register_test(registered_names[i].c_str(), empty_test);
+  n_registered = std::max(n_registered, n);
+}
+
+void prepare_tap_emission(size_t n) {
+  prepare_names(n);
+  registry_register(n);
+}
+
+void tap_emission(size_t) {
+  // runs the tests registered by prepare_tap_emission
+  null_buffer nb;
+  std::streambuf *old = std::cout.rdbuf(&nb);
+  miutil::cpptest::run_tests(0, nullptr);
+  std::cout.rdbuf(old);
+}
+
+const size_t N_REGISTERED = 100000;
+
+const bench benchmarks[] = {
+    {"check_eq_pass", 100000000, check_eq_pass, nullptr},
+    {"check_eq_fail", 1000000, check_eq_fail, nullptr},
+    {"check_close_pass", 100000000, check_close_pass, nullptr},
+    {"check_close_fail", 1000000, check_close_fail, nullptr},
+    {"stringify_int", 10000000, stringify_int, nullptr},
+    {"stringify_double", 1000000, stringify_double, nullptr},
+    {"stringify_vector_double_100", 10000, stringify_vector_double, nullptr},
+    {"stringify_map_int_string_100", 10000, stringify_map_int_string, nullptr},
+    {"stringify_pair_int_double", 1000000, stringify_pair, nullptr},
+    {"recorder_record", 1000000, recorder_record, nullptr},
+    {"registry_register", N_REGISTERED, registry_register, prepare_names},
+    {"tap_emission", N_REGISTERED, tap_emission, prepare_tap_emission},
+};
+
+void write_result(std::ostream &out, const char *name, size_t iterations,
+                  double seconds) {
+  const double ns_per_op = seconds * 1e9 / iterations;
+  out << "{\"benchmark\":\"" << name << "\",\"iterations\":" << iterations
+      << ",\"seconds\":" << seconds << ",\"ns_per_op\":" << ns_per_op
+      << ",\"ops_per_second\":";
+  // JSON has no infinity
+  if (seconds > 0)
+    out << (iterations / seconds);
+  else
+    out << "null";
+  out << "}" << std::endl;
+}
+
+} // namespace
+
+// Arguments are regular expressions selecting benchmarks by name; without
+// arguments, all benchmarks are run. "--scale=F" multiplies the number of
+// iterations by F, e.g. 0.001 for a quick smoke test.
+int main(int argc, char *args[]) {
+  std::vector<std::regex> filters;
+  double scale = 1;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = args[i];
+    if (arg.compare(0, 8, "--scale=") == 0) {
+      const char *value = args[i] + 8;
+      char *end = nullptr;
+      scale = std::strtod(value, &end);
+      if (end == value || *end != 0 || !(scale > 0)) {
+        std::cerr << "bad scale '" << value
+                  << "', expected a positive number" << std::endl;
+        return 1;
+      }
+    } else {
+      filters.push_back(std::regex(arg));
+    }
+  }
+
+  for (const bench &b : benchmarks) {
+    bool selected = filters.empty();
+    for (const auto &f : filters) {
+      if (std::regex_search(b.name, f)) {
+        selected = true;
+        break;
+      }
+    }
+    if (!selected)
+      continue;
+
+    const size_t iterations =
+        std::max<size_t>(1, static_cast<size_t>(b.iterations * scale));
+    if (b.prepare)
+      b.prepare(iterations);
+    const auto start = std::chrono::steady_clock::now();
+    b.function(iterations);
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    write_result(std::cout, b.name, iterations, elapsed.count());
+  }
+  return 0;
+}
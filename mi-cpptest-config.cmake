@@ -1,2 +1,4 @@
+include(CMakeFindDependencyMacro)
+find_dependency(Threads)
 get_filename_component(SELF_DIR "${CMAKE_CURRENT_LIST_FILE}" PATH)
 include(${SELF_DIR}/mi-cpptest-targets.cmake)
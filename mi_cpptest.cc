@@ -28,12 +28,24 @@
 */
 
 #include "mi_cpptest.h"
+#include "mi_cpptest_impact.h"
+#include "mi_cpptest_profiler.h"
 
+#if __cplusplus >= 201703L
+#include <charconv>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <regex>
 #include <stdexcept>
 #include <string>
 #include <sstream>
+#include <utility>
 
 namespace {
 
@@ -85,6 +97,45 @@ std::string strip_common_prefix(const std::string &from,
   return from.substr(common);
 }
 
+std::string &formatter_buffer() {
+  thread_local std::string buffer;
+  return buffer;
+}
+
+// appends to the formatter's buffer
+class string_append_buffer : public std::streambuf {
+public:
+  string_append_buffer(std::string &buffer) : buffer_(buffer) {}
+
+protected:
+  int overflow(int c) override {
+    if (c != traits_type::eof())
+      buffer_.push_back(traits_type::to_char_type(c));
+    return traits_type::not_eof(c);
+  }
+  std::streamsize xsputn(const char *s, std::streamsize n) override {
+    buffer_.append(s, n);
+    return n;
+  }
+
+private:
+  std::string &buffer_;
+};
+
+#if !defined(__cpp_lib_to_chars)
+// shortest "%g" precision that reads back as the same value
+template <class T>
+size_t format_floating(char *buf, T v, const char *fmt, T (*parse)(const char *, char **)) {
+  int n = 0;
+  for (int p = std::numeric_limits<T>::digits10; p <= std::numeric_limits<T>::max_digits10; ++p) {
+    n = std::snprintf(buf, miutil::cpptest::format_number_size, fmt, p, v);
+    if (parse(buf, nullptr) == v)
+      break;
+  }
+  return n;
+}
+#endif
+
 } // namespace
 
 namespace miutil {
@@ -94,24 +145,203 @@ void mi_cpptest_stringify_missing(std::ostream &out) {
   out << "???";
 }
 
+#if defined(__cpp_lib_to_chars)
+
+size_t format_number(char *buf, long long v) {
+  return std::to_chars(buf, buf + format_number_size, v).ptr - buf;
+}
+
+size_t format_number(char *buf, unsigned long long v) {
+  return std::to_chars(buf, buf + format_number_size, v).ptr - buf;
+}
+
+size_t format_number(char *buf, float v) {
+  return std::to_chars(buf, buf + format_number_size, v).ptr - buf;
+}
+
+size_t format_number(char *buf, double v) {
+  return std::to_chars(buf, buf + format_number_size, v).ptr - buf;
+}
+
+size_t format_number(char *buf, long double v) {
+  return std::to_chars(buf, buf + format_number_size, v).ptr - buf;
+}
+
+#else // !__cpp_lib_to_chars
+
+size_t format_number(char *buf, long long v) {
+  return std::snprintf(buf, format_number_size, "%lld", v);
+}
+
+size_t format_number(char *buf, unsigned long long v) {
+  return std::snprintf(buf, format_number_size, "%llu", v);
+}
+
+size_t format_number(char *buf, float v) {
+  return format_floating<float>(buf, v, "%.*g", std::strtof);
+}
+
+size_t format_number(char *buf, double v) {
+  return format_floating<double>(buf, v, "%.*g", std::strtod);
+}
+
+size_t format_number(char *buf, long double v) {
+  return format_floating<long double>(buf, v, "%.*Lg", std::strtold);
+}
+
+#endif // !__cpp_lib_to_chars
+
+formatter::formatter()
+    : buffer_(formatter_buffer()), start_(buffer_.size()) {}
+
+formatter::~formatter() {
+  stream_.reset();
+  buffer_.resize(start_);
+}
+
+std::ostream &formatter::stream() {
+  if (!stream_) {
+    streambuf_.reset(new string_append_buffer(buffer_));
+    stream_.reset(new std::ostream(streambuf_.get()));
+  }
+  return *stream_;
+}
+
 std::string test_recorder::file_prefix_;
 
+struct test_recorder::thread_messages {
+  std::vector<std::string> messages;
+  thread_messages *next;
+};
+
+namespace {
+
+std::atomic<unsigned long> next_recorder_serial(1);
+
+// buffer of the calling thread for the recorder with this serial number
+struct thread_buffer_cache {
+  unsigned long serial;
+  std::vector<std::string> *messages;
+};
+thread_local thread_buffer_cache thread_buffer_cache_ = {0, nullptr};
+
+thread_local test_recorder *current_recorder_ = nullptr;
+std::atomic<test_recorder *> running_recorder_(nullptr);
+
+} // namespace
+
+test_recorder::test_recorder()
+    : owner_(std::this_thread::get_id()), serial_(next_recorder_serial++),
+      threads_(nullptr), aborted_(false) {}
+
+test_recorder::~test_recorder() {
+  thread_messages *tm = threads_.load();
+  while (tm) {
+    thread_messages *next = tm->next;
+    delete tm;
+    tm = next;
+  }
+}
+
+std::vector<std::string> &test_recorder::thread_buffer() {
+  thread_buffer_cache &cache = thread_buffer_cache_;
+  if (cache.serial != serial_) {
+    thread_messages *tm = new thread_messages;
+    tm->next = threads_.load();
+    while (!threads_.compare_exchange_weak(tm->next, tm)) {
+    }
+    cache.serial = serial_;
+    cache.messages = &tm->messages;
+  }
+  return *cache.messages;
+}
+
+void test_recorder::finish() {
+  std::vector<std::vector<std::string> *> groups;
+  for (thread_messages *tm = threads_.load(); tm; tm = tm->next) {
+    if (!tm->messages.empty())
+      groups.push_back(&tm->messages);
+  }
+  std::sort(groups.begin(), groups.end(),
+            [](const std::vector<std::string> *a,
+               const std::vector<std::string> *b) { return *a < *b; });
+  for (std::vector<std::string> *g : groups) {
+    std::move(g->begin(), g->end(), std::back_inserter(messages_));
+    g->clear();
+  }
+}
+
+test_recorder *test_recorder::current() {
+  if (current_recorder_)
+    return current_recorder_;
+  return running_recorder_.load();
+}
+
 void test_recorder::record(const char *file, int line,
                            const std::string &note) {
-  std::ostringstream msg;
+  std::string msg;
   if (line >= 0) {
-    msg << strip_common_prefix(file, file_prefix_, "/:.") << ":" << line;
+    msg = strip_common_prefix(file, file_prefix_, "/:.");
+    msg += ':';
+    msg += std::to_string(line);
   }
   if (!note.empty()) {
     if (line >= 0)
-      msg << ' ';
-    msg << note;
+      msg += ' ';
+    msg += note;
   }
-  messages_.push_back(msg.str());
+  if (std::this_thread::get_id() == owner_)
+    messages_.push_back(std::move(msg));
+  else
+    thread_buffer().push_back(std::move(msg));
 }
 
 test_status test_recorder::status() const {
-  return messages_.empty() ? OK : FAIL;
+  if (!messages_.empty())
+    return FAIL;
+  for (const thread_messages *tm = threads_.load(); tm; tm = tm->next) {
+    if (!tm->messages.empty())
+      return FAIL;
+  }
+  return OK;
+}
+
+current_test_recorder::current_test_recorder(test_recorder *tr)
+    : previous_(current_recorder_) {
+  current_recorder_ = tr;
+}
+
+current_test_recorder::~current_test_recorder() {
+  current_recorder_ = previous_;
+}
+
+test_thread::test_thread(test_recorder *tr, std::function<void()> f)
+    : recorder_(tr), thread_(&test_thread::run, tr, std::move(f)) {}
+
+test_thread::~test_thread() {
+  if (thread_.joinable())
+    thread_.join();
+}
+
+void test_thread::join() {
+  thread_.join();
+  if (recorder_->aborted())
+    throw test_failure();
+}
+
+void test_thread::run(test_recorder *tr, std::function<void()> f) {
+  current_test_recorder current(tr);
+  try {
+    f();
+    return;
+  } catch (const test_failure &) {
+    // recorded by the failing check
+  } catch (std::exception &e) {
+    tr->record("", -1, "uncaught exception: " + std::string(e.what()));
+  } catch (...) {
+    tr->record("", -1, "uncaught exception");
+  }
+  tr->set_aborted();
 }
 
 typedef std::vector<registered_test> registered_test_v;
@@ -122,12 +352,23 @@ registered_test_v& registered_tests()
     return tests;
 }
 
+std::string& test_name_prefix()
+{
+    static std::string prefix;
+    return prefix;
+}
+
 bool register_test(const char* name, test_function_t tf)
 {
-    registered_tests().push_back(registered_test {name, tf});
+    registered_tests().push_back(registered_test {test_name_prefix() + name, tf});
     return true;
 }
 
+void set_test_name_prefix(const std::string &prefix)
+{
+    test_name_prefix() = prefix;
+}
+
 void write_test_status(std::ostream &out, test_status status, size_t number,
                        const registered_test &rt, const std::string &message) {
   if (status == FAIL)
@@ -149,8 +390,44 @@ bool run_tests(size_t npatterns, char* patterns[])
     std::vector<test_filter> filters;
     filters.reserve(npatterns);
     size_t n_exclusive = 0;
+    std::unique_ptr<sampling_profiler> profiler;
+    std::string impact_map_file = "mi-cpptest-impact.map";
+    bool record_impact = false;
+    bool select_affected = false;
+    std::vector<std::string> changed_files;
     for (size_t i=0; i<npatterns; ++i) {
         char* pattern = patterns[i];
+        if (std::strncmp(pattern, "--", 2) == 0) {
+            const std::string option(pattern);
+            if (option == "--profile" || option.compare(0, 10, "--profile=") == 0) {
+                if (!sampling_profiler::supported()) {
+                    std::cerr << "profiling is not supported on this platform" << std::endl;
+                    return false;
+                }
+                const std::string dir = (option.size() > 10) ? option.substr(10) : "mi-cpptest-profile";
+                profiler.reset(new sampling_profiler(dir));
+                if (!profiler->ok()) {
+                    std::cerr << "running tests without profiling" << std::endl;
+                    profiler.reset();
+                }
+            } else if (option.compare(0, 13, "--impact-map=") == 0) {
+                impact_map_file = option.substr(13);
+            } else if (option == "--record-impact") {
+                if (!impact_recorder::supported()) {
+                    std::cerr << "--record-impact requires a program built with gcov instrumentation" << std::endl;
+                    return false;
+                }
+                record_impact = true;
+            } else if (option == "--affected-by") {
+                select_affected = true;
+                while (i + 1 < npatterns && std::strncmp(patterns[i + 1], "--", 2) != 0)
+                    changed_files.push_back(patterns[++i]);
+            } else {
+                std::cerr << "unknown option '" << option << "'" << std::endl;
+                return false;
+            }
+            continue;
+        }
         test_filter tf;
         tf.exclusive = (pattern[0] == '-');
         if (tf.exclusive) {
@@ -162,6 +439,21 @@ bool run_tests(size_t npatterns, char* patterns[])
     }
     const bool use_default = (filters.empty() || n_exclusive == filters.size());
 
+    impact_map impact(impact_map::current_program());
+    if ((record_impact || select_affected) && !impact.read(impact_map_file)) {
+        std::cerr << "cannot read impact map '" << impact_map_file << "'" << std::endl;
+        return false;
+    }
+    std::unique_ptr<impact_recorder> impact_rec;
+    if (record_impact) {
+        impact_rec.reset(new impact_recorder());
+        if (!impact_rec->ok()) {
+            std::cerr << "running tests without recording impact" << std::endl;
+            impact_rec.reset();
+            record_impact = false;
+        }
+    }
+
     std::cout << "TAP version 13" << std::endl
               << "1.." << registered_tests().size() << std::endl;
     bool all_passed = true;
@@ -179,10 +471,18 @@ bool run_tests(size_t npatterns, char* patterns[])
                 break;
             }
         }
+        if (status != SKIP && select_affected && !impact.affected(rt.name, changed_files))
+            status = SKIP;
 
         if (status != SKIP) {
           test_recorder tr;
+          running_recorder_ = &tr;
+          if (impact_rec)
+            impact_rec->start();
+          if (profiler)
+            profiler->start();
           try {
+            current_test_recorder current(&tr);
             rt(&tr);
           } catch (const test_failure &tf) {
             // recorded in test_recorder::fail
@@ -192,6 +492,15 @@ bool run_tests(size_t npatterns, char* patterns[])
           } catch (...) {
             tr.record("", -1, "uncaught exception");
           }
+          running_recorder_ = nullptr;
+          if (profiler) {
+            profiler->stop();
+            if (!profiler->write(rt.name))
+              std::cerr << "cannot write profile for '" << rt.name << "'" << std::endl;
+          }
+          if (impact_rec)
+            impact.set(rt.name, impact_rec->stop());
+          tr.finish();
           status = tr.status();
           if (status != OK) {
             all_passed = false;
@@ -209,6 +518,10 @@ bool run_tests(size_t npatterns, char* patterns[])
         }
         write_test_status(std::cout, status, test_number, rt, message);
     }
+    if (profiler && !profiler->write_summary())
+        std::cerr << "cannot write profile summary" << std::endl;
+    if (record_impact && !impact.write(impact_map_file))
+        std::cerr << "cannot write impact map '" << impact_map_file << "'" << std::endl;
     return all_passed;
 }
 
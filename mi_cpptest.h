@@ -31,12 +31,15 @@
 #ifndef MI_CPPTEST_H
 #define MI_CPPTEST_H
 
+#include <atomic>
 #include <cmath>
 #include <cstdlib>
 #include <functional>
 #include <memory>
 #include <ostream>
 #include <sstream>
+#include <string>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
@@ -64,10 +67,65 @@ struct has_mi_cpptest_stringify : std::false_type {};
 template <typename T>
 struct has_mi_cpptest_stringify<T, std::void_t<decltype(mi_cpptest_stringify(std::declval<std::ostream&>(), std::declval<T>()))>> : std::true_type {};
 
+// arithmetic types written with format_number; bool and character types are
+// left to std::ostream, and integers wider than long long (e.g. __int128 in
+// gnu mode) are not formatted as numbers
+template <typename T>
+struct is_formatted_number
+    : std::integral_constant<
+          bool, std::is_arithmetic<T>::value && !std::is_same<T, bool>::value &&
+                    !(std::is_integral<T>::value && sizeof(T) > sizeof(long long)) &&
+                    !std::is_same<T, char>::value &&
+                    !std::is_same<T, signed char>::value &&
+                    !std::is_same<T, unsigned char>::value &&
+                    !std::is_same<T, wchar_t>::value &&
+                    !std::is_same<T, char16_t>::value &&
+                    !std::is_same<T, char32_t>::value> {};
+
+//! buffer size sufficient for all format_number overloads
+const size_t format_number_size = 64;
+
+//! write the shortest representation that reads back as the same value
+size_t format_number(char *buf, long long v);
+size_t format_number(char *buf, unsigned long long v);
+size_t format_number(char *buf, float v);
+size_t format_number(char *buf, double v);
+size_t format_number(char *buf, long double v);
+
+template <class T>
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, size_t>::type
+format_arithmetic(char *buf, T v) {
+  return format_number(buf, static_cast<long long>(v));
+}
+
+template <class T>
+typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value, size_t>::type
+format_arithmetic(char *buf, T v) {
+  return format_number(buf, static_cast<unsigned long long>(v));
+}
+
+template <class T>
+typename std::enable_if<std::is_floating_point<T>::value, size_t>::type
+format_arithmetic(char *buf, T v) {
+  return format_number(buf, v);
+}
+
+//! true if the stream formats like a newly constructed stream
+inline bool has_default_format(const std::ios_base &s) {
+  return s.flags() == (std::ios_base::dec | std::ios_base::skipws) &&
+         s.precision() == 6 && s.width() == 0;
+}
+
+class formatter;
+
+//! stream writing into the formatter's buffer, for values that are not numbers
+std::ostream &formatter_stream(formatter &f);
+
 template <class C, typename = void>
 struct stringifier {
   stringifier(const C& c) : c_(c) {}
   void write(std::ostream &out) const { mi_cpptest_stringify_missing(out); }
+  void write(formatter &out) const { write(formatter_stream(out)); }
   const C &c_;
 };
 
@@ -87,20 +145,37 @@ template <class C>
 struct stringifier<C, typename std::enable_if<has_mi_cpptest_stringify<C>::value>::type> {
   stringifier(const C &c) : c_(c) {}
   void write(std::ostream &out) const { mi_cpptest_stringify(out, c_); }
+  void write(formatter &out) const { write(formatter_stream(out)); }
+  const C &c_;
+};
+
+template <class C>
+struct stringifier<C, typename std::enable_if<is_formatted_number<C>::value && !has_mi_cpptest_stringify<C>::value>::type> {
+  stringifier(const C &c) : c_(c) {}
+  void write(std::ostream &out) const {
+    if (has_default_format(out)) {
+      char buf[format_number_size];
+      out.write(buf, format_arithmetic(buf, c_));
+    } else {
+      out << c_;
+    }
+  }
+  void write(formatter &out) const { out << c_; }
   const C &c_;
 };
 
 template <class C>
-struct stringifier<C, typename std::enable_if<has_output_operator<C>::value && !has_mi_cpptest_stringify<C>::value>::type> {
+struct stringifier<C, typename std::enable_if<has_output_operator<C>::value && !is_formatted_number<C>::value && !has_mi_cpptest_stringify<C>::value>::type> {
   stringifier(const C &c) : c_(c) {}
   void write(std::ostream &out) const { out << c_; }
+  void write(formatter &out) const { write(formatter_stream(out)); }
   const C &c_;
 };
 
 template <class C>
 struct stringifier<C, typename std::enable_if<is_iterable<C>::value && !has_output_operator<C>::value && !has_mi_cpptest_stringify<C>::value>::type> {
   stringifier(const C &c) : c_(c) {}
-  void write(std::ostream &out) const {
+  template <class S> void write(S &out) const {
     char sep = '{';
     for (const auto &e : c_) {
       out << sep << stringify(e);
@@ -115,30 +190,191 @@ template <class A, class B>
 struct stringifier<std::pair<A, B>> {
   typedef typename std::pair<A, B> P;
   stringifier(const P &p) : p_(p) {}
-  void write(std::ostream &out) const {
+  template <class S> void write(S &out) const {
     out << '<' << stringify(p_.first) << ',' << stringify(p_.second) << '>';
   }
   const P &p_;
 };
 
+/*! Collects a failure message.
+ *
+ * Numbers are written with format_number, strings are appended directly,
+ * and everything else goes through an std::ostream which is created only
+ * when needed. All formatters in a thread share one growing buffer, so
+ * that formatting a message usually does not allocate.
+ */
+class formatter {
+public:
+  formatter();
+  ~formatter();
+
+  formatter(const formatter &) = delete;
+  formatter &operator=(const formatter &) = delete;
+
+  formatter &write(const char *s, size_t n) {
+    buffer_.append(s, n);
+    return *this;
+  }
+
+  formatter &operator<<(const char *s) {
+    buffer_.append(s);
+    return *this;
+  }
+
+  formatter &operator<<(const std::string &s) {
+    buffer_.append(s);
+    return *this;
+  }
+
+  formatter &operator<<(char c) {
+    buffer_.push_back(c);
+    return *this;
+  }
+
+  template <class T>
+  typename std::enable_if<is_formatted_number<T>::value, formatter &>::type
+  operator<<(T v) {
+    if (stream_ && !has_default_format(*stream_)) {
+      *stream_ << v;
+      return *this;
+    }
+    char buf[format_number_size];
+    return write(buf, format_arithmetic(buf, v));
+  }
+
+  template <class C> formatter &operator<<(const stringifier<C> &s) {
+    s.write(*this);
+    return *this;
+  }
+
+  template <class T>
+  typename std::enable_if<!is_formatted_number<T>::value, formatter &>::type
+  operator<<(const T &v) {
+    stream() << v;
+    return *this;
+  }
+
+  formatter &operator<<(std::ostream &(*manip)(std::ostream &)) {
+    stream() << manip;
+    return *this;
+  }
+
+  formatter &operator<<(std::ios_base &(*manip)(std::ios_base &)) {
+    stream() << manip;
+    return *this;
+  }
+
+  std::ostream &stream();
+
+  //! text written by this formatter
+  std::string str() const { return buffer_.substr(start_); }
+
+private:
+  std::string &buffer_;
+  const size_t start_;
+  std::unique_ptr<std::streambuf> streambuf_;
+  std::unique_ptr<std::ostream> stream_;
+};
+
+inline std::ostream &formatter_stream(formatter &f) { return f.stream(); }
+
 struct test_failure : public std::exception {};
 
 enum test_status { OK = 0, FAIL, SKIP };
 
 class test_recorder {
 public:
+  test_recorder();
+  ~test_recorder();
+
+  test_recorder(const test_recorder &) = delete;
+  test_recorder &operator=(const test_recorder &) = delete;
+
+  /*! Record a failure.
+   *
+   * May be called from any thread. Messages from threads other than the one
+   * that created the recorder go to a buffer owned by the calling thread,
+   * and are added to messages() by finish().
+   */
   void record(const char *file, int line,
               const std::string &msg = std::string());
+
+  /*! Add messages recorded by other threads, grouped by thread.
+   *
+   * Groups are sorted by their messages so that the order does not depend
+   * on thread scheduling. All other threads must have stopped recording.
+   */
+  void finish();
+
   test_status status() const;
   const std::vector<std::string> &messages() const { return messages_; }
 
+  //! mark the test as aborted, e.g. after REQUIRE failed in a test_thread
+  void set_aborted() { aborted_ = true; }
+  bool aborted() const { return aborted_; }
+
+  /*! The recorder of the running test.
+   *
+   * This is the recorder set by current_test_recorder in the calling
+   * thread, or else the recorder of the test being run by run_tests.
+   *
+   * In threads not started as test_thread, only CHECK macros may be used:
+   * a failing REQUIRE throws test_failure, which ends the program if it
+   * escapes the thread function.
+   */
+  static test_recorder *current();
+
   static void set_file_prefix(const std::string &prefix) {
     file_prefix_ = prefix;
   }
 
 private:
+  struct thread_messages;
+  std::vector<std::string> &thread_buffer();
+
   static std::string file_prefix_;
   std::vector<std::string> messages_;
+  const std::thread::id owner_;
+  const unsigned long serial_;
+  std::atomic<thread_messages *> threads_;
+  std::atomic<bool> aborted_;
+};
+
+//! makes a recorder the current one in this thread
+class current_test_recorder {
+public:
+  current_test_recorder(test_recorder *tr);
+  ~current_test_recorder();
+
+  current_test_recorder(const current_test_recorder &) = delete;
+  current_test_recorder &operator=(const current_test_recorder &) = delete;
+
+private:
+  test_recorder *previous_;
+};
+
+/*! Thread for use inside a test.
+ *
+ * The thread function may use the usual checks with the test's recorder,
+ * which is also the current recorder in the thread. If a REQUIRE fails or
+ * an exception escapes, the thread function ends and the test is aborted:
+ * join() then throws test_failure. The destructor joins without throwing.
+ */
+class test_thread {
+public:
+  test_thread(test_recorder *tr, std::function<void()> f);
+  ~test_thread();
+
+  test_thread(const test_thread &) = delete;
+  test_thread &operator=(const test_thread &) = delete;
+
+  void join();
+
+private:
+  static void run(test_recorder *tr, std::function<void()> f);
+
+  test_recorder *recorder_;
+  std::thread thread_;
 };
 
 class test_fixture {
@@ -162,6 +398,9 @@ typedef void (*test_function_t)(test_recorder *);
 
 bool register_test(const char* name, test_function_t tf);
 
+//! prefix for the names of tests registered later, e.g. by a loaded module
+void set_test_name_prefix(const std::string &prefix);
+
 bool run_tests(size_t npatterns, char* patterns[]);
 bool run_tests_with_prefix(int argc, char *args[]);
 
@@ -209,7 +448,7 @@ template <class C> struct is_near {
 #define MI_CPPTEST___RECORD(fatal, x, m)                                       \
   do {                                                                         \
     if (!static_cast<bool>(x)) {                                               \
-      std::ostringstream msg;                                                  \
+      miutil::cpptest::formatter msg;                                          \
       msg << m;                                                                \
       mi_cpptest_recorder->record(__FILE__, __LINE__, msg.str());              \
       if (fatal)                                                               \
@@ -0,0 +1,521 @@
+/*
+  mi-cpptest
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: diana@met.no
+
+  This file is part of mi-cpptest.
+
+  mi-cpptest is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  mi-cpptest is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with mi-cpptest; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "mi_cpptest_impact.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#if defined(__linux__) && defined(__GNUC__)
+#define MI_CPPTEST_HAVE_IMPACT 1
+#endif
+
+#ifdef MI_CPPTEST_HAVE_IMPACT
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" void __gcov_dump(void) __attribute__((weak));
+extern "C" void __gcov_reset(void) __attribute__((weak));
+#endif
+
+namespace {
+
+#ifdef MI_CPPTEST_HAVE_IMPACT
+const uint32_t GCOV_DATA_MAGIC = 0x67636461;  // "gcda"
+const uint32_t GCOV_NOTE_MAGIC = 0x67636e6f;  // "gcno"
+const uint32_t GCOV_TAG_FUNCTION = 0x01000000;
+const uint32_t GCOV_TAG_LINES = 0x01450000;
+const uint32_t GCOV_TAG_COUNTER_BASE = 0x01a10000;
+
+const char GCDA_SUFFIX[] = ".gcda";
+const size_t GCDA_SUFFIX_LENGTH = sizeof(GCDA_SUFFIX) - 1;
+#endif // MI_CPPTEST_HAVE_IMPACT
+
+std::string normalized_path(const std::string &path) {
+  std::vector<std::string> parts;
+  std::istringstream in(path);
+  std::string part;
+  while (std::getline(in, part, '/')) {
+    if (part.empty() || part == ".")
+      continue;
+    if (part == ".." && !parts.empty() && parts.back() != "..")
+      parts.pop_back();
+    else
+      parts.push_back(part);
+  }
+  std::string normalized = (!path.empty() && path[0] == '/') ? "/" : "";
+  for (size_t i = 0; i < parts.size(); ++i) {
+    if (i > 0)
+      normalized += '/';
+    normalized += parts[i];
+  }
+  return normalized;
+}
+
+std::string absolute_path(const std::string &path) {
+#ifdef MI_CPPTEST_HAVE_IMPACT
+  if (!path.empty() && path[0] == '/')
+    return normalized_path(path);
+  char cwd[4096];
+  if (getcwd(cwd, sizeof(cwd)))
+    return normalized_path(std::string(cwd) + "/" + path);
+#endif
+  return normalized_path(path);
+}
+
+#ifdef MI_CPPTEST_HAVE_IMPACT
+
+bool read_file(const std::string &path, std::string &data) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    return false;
+  std::ostringstream contents;
+  contents << in.rdbuf();
+  data = contents.str();
+  return true;
+}
+
+// reads gcov data and note files, see gcc/gcov-io.h
+class gcov_reader {
+public:
+  gcov_reader(const std::string &data) : data_(data), pos_(0), major_(0) {}
+
+  //! read magic and version and the rest of the header
+  bool header(uint32_t magic) {
+    uint32_t m, version, stamp, checksum;
+    if (!u32(m) || m != magic || !u32(version) || !u32(stamp))
+      return false;
+    // version "B22*" is 12.2, "A93*" is 9.3
+    const int c0 = (version >> 24) & 0xFF, c1 = (version >> 16) & 0xFF;
+    if (c0 < 'A' || c1 < '0' || c1 > '9')
+      return false;
+    major_ = (c0 - 'A') * 10 + (c1 - '0');
+    if (major_ < 9)
+      return false;
+    return major_ < 12 || u32(checksum);
+  }
+
+  bool u32(uint32_t &v) {
+    if (pos_ + 4 > data_.size())
+      return false;
+    std::memcpy(&v, data_.data() + pos_, 4);
+    pos_ += 4;
+    return true;
+  }
+
+  bool string(std::string &s) {
+    uint32_t length;
+    if (!u32(length))
+      return false;
+    const size_t bytes = bytes_lengths() ? length : size_t(length) * 4;
+    if (pos_ + bytes > data_.size())
+      return false;
+    s.assign(data_.data() + pos_, bytes);
+    s.resize(std::strlen(s.c_str()));
+    pos_ += bytes;
+    return true;
+  }
+
+  //! read a record header, giving the payload length in bytes; tag 0 ends the file
+  bool record(uint32_t &tag, size_t &length, bool &zero_counters) {
+    uint32_t l;
+    if (!u32(tag))
+      return false;
+    if (tag == 0) {
+      length = 0;
+      zero_counters = false;
+      return at_end();
+    }
+    if (!u32(l))
+      return false;
+    zero_counters = false;
+    if (!bytes_lengths()) {
+      length = size_t(l) * 4;
+    } else if (int32_t(l) < 0) {
+      // gcc 12 writes all-zero counters as negative length without data
+      zero_counters = true;
+      length = 0;
+    } else {
+      length = l;
+    }
+    return pos_ + length <= data_.size();
+  }
+
+  bool nonzero(size_t length) const {
+    for (size_t i = 0; i < length; ++i) {
+      if (data_[pos_ + i] != 0)
+        return true;
+    }
+    return false;
+  }
+
+  size_t pos() const { return pos_; }
+  void seek(size_t pos) { pos_ = pos; }
+  bool at_end() const { return pos_ == data_.size(); }
+
+private:
+  bool bytes_lengths() const { return major_ >= 12; }
+
+  const std::string &data_;
+  size_t pos_;
+  int major_;
+};
+
+bool is_counter_tag(uint32_t tag) {
+  // GCOV_TAG_COUNTER_BASE + (counter type << 17)
+  return tag >= GCOV_TAG_COUNTER_BASE && (tag & 0xFF01FFFF) == 0x01010000;
+}
+
+//! find idents of functions with non-zero counters
+bool parse_gcda(const std::string &data, std::set<uint32_t> &executed) {
+  gcov_reader r(data);
+  if (!r.header(GCOV_DATA_MAGIC))
+    return false;
+  uint32_t ident = 0;
+  bool have_function = false;
+  while (!r.at_end()) {
+    uint32_t tag;
+    size_t length;
+    bool zero_counters;
+    if (!r.record(tag, length, zero_counters))
+      return false;
+    if (tag == 0)
+      break;
+    const size_t end = r.pos() + length;
+    if (tag == GCOV_TAG_FUNCTION) {
+      have_function = (length > 0);
+      if (have_function && !r.u32(ident))
+        return false;
+    } else if (is_counter_tag(tag)) {
+      if (!have_function)
+        return false;
+      if (!zero_counters && r.nonzero(length))
+        executed.insert(ident);
+    } else if ((tag >> 24) != 0xA1 && (tag >> 24) != 0xA3) {
+      // not a summary
+      return false;
+    }
+    r.seek(end);
+  }
+  return true;
+}
+
+//! find the source files of each function
+bool parse_gcno(const std::string &data,
+                std::map<uint32_t, std::set<std::string>> &files) {
+  gcov_reader r(data);
+  std::string cwd;
+  uint32_t unexecuted_blocks;
+  if (!r.header(GCOV_NOTE_MAGIC) || !r.string(cwd) || !r.u32(unexecuted_blocks))
+    return false;
+  std::set<std::string> *function_files = nullptr;
+  const auto add = [&](const std::string &f) {
+    function_files->insert(absolute_path(f[0] == '/' ? f : cwd + "/" + f));
+  };
+  while (!r.at_end()) {
+    uint32_t tag;
+    size_t length;
+    bool zero_counters;
+    if (!r.record(tag, length, zero_counters))
+      return false;
+    if (tag == 0)
+      break;
+    const size_t end = r.pos() + length;
+    if (tag == GCOV_TAG_FUNCTION) {
+      uint32_t ident, lineno_checksum, cfg_checksum, artificial;
+      std::string name, source;
+      if (!r.u32(ident) || !r.u32(lineno_checksum) || !r.u32(cfg_checksum) ||
+          !r.string(name) || !r.u32(artificial) || !r.string(source) ||
+          source.empty() || r.pos() > end)
+        return false;
+      function_files = &files[ident];
+      add(source);
+    } else if (tag == GCOV_TAG_LINES) {
+      uint32_t block;
+      if (!function_files || !r.u32(block))
+        return false;
+      while (r.pos() < end) {
+        uint32_t line;
+        if (!r.u32(line))
+          return false;
+        if (line == 0) {
+          std::string source;
+          if (!r.string(source))
+            return false;
+          if (source.empty())
+            break;
+          add(source);
+        }
+      }
+      if (r.pos() > end)
+        return false;
+    }
+    r.seek(end);
+  }
+  return true;
+}
+
+std::vector<std::string> *found_gcda_files = nullptr;
+
+int add_gcda_file(const char *path, const struct stat *, int type, struct FTW *) {
+  const size_t length = std::strlen(path);
+  if (type == FTW_F && length > GCDA_SUFFIX_LENGTH &&
+      std::strcmp(path + length - GCDA_SUFFIX_LENGTH, GCDA_SUFFIX) == 0)
+    found_gcda_files->push_back(path);
+  return 0;
+}
+
+int remove_entry(const char *path, const struct stat *, int, struct FTW *) {
+  std::remove(path);
+  return 0;
+}
+
+int remove_contained_entry(const char *path, const struct stat *, int,
+                           struct FTW *ftw) {
+  if (ftw->level > 0)
+    std::remove(path);
+  return 0;
+}
+
+void remove_tree(const std::string &path) {
+  nftw(path.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+void remove_contents(const std::string &path) {
+  nftw(path.c_str(), remove_contained_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+// sets or unsets an environment variable for the lifetime of this object
+class environment_override {
+public:
+  environment_override(const char *name, const char *value) : name_(name) {
+    const char *old = std::getenv(name);
+    had_value_ = (old != nullptr);
+    if (had_value_)
+      old_value_ = old;
+    if (value)
+      setenv(name, value, 1);
+    else
+      unsetenv(name);
+  }
+  ~environment_override() {
+    if (had_value_)
+      setenv(name_, old_value_.c_str(), 1);
+    else
+      unsetenv(name_);
+  }
+
+private:
+  const char *name_;
+  bool had_value_;
+  std::string old_value_;
+};
+
+#endif // MI_CPPTEST_HAVE_IMPACT
+
+} // namespace
+
+namespace miutil {
+namespace cpptest {
+
+std::string impact_map::current_program() {
+#ifdef MI_CPPTEST_HAVE_IMPACT
+  char exe[4096];
+  const ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+  if (n <= 0)
+    return std::string();
+  const std::string path(exe, n);
+  return path.substr(path.rfind('/') + 1);
+#else
+  return std::string();
+#endif
+}
+
+bool impact_map::read(const std::string &path) {
+  std::ifstream in(path);
+  if (!in)
+    return errno == ENOENT;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::istringstream fields(line);
+    std::string program, test, file;
+    std::getline(fields, program, '\t');
+    std::getline(fields, test, '\t');
+    files_t &files = tests_[key_t(program, test)];
+    while (std::getline(fields, file, '\t'))
+      files.insert(file);
+  }
+  return true;
+}
+
+bool impact_map::write(const std::string &path) const {
+  std::ofstream out(path);
+  out << "# mi-cpptest impact map: program, test name and executed source files\n";
+  for (const auto &t : tests_) {
+    out << t.first.first << '\t' << t.first.second;
+    for (const auto &f : t.second)
+      out << '\t' << f;
+    out << '\n';
+  }
+  return static_cast<bool>(out);
+}
+
+bool impact_map::affected(const std::string &test,
+                          const std::vector<std::string> &changed) const {
+  const auto it = tests_.find(key(test));
+  if (it == tests_.end() || it->second.empty())
+    return true;
+  const files_t &files = it->second;
+  for (const std::string &c : changed) {
+    if (files.count(absolute_path(c)))
+      return true;
+    if (!c.empty() && c[0] != '/') {
+      const std::string suffix = "/" + normalized_path(c);
+      for (const std::string &f : files) {
+        if (f.size() > suffix.size() &&
+            f.compare(f.size() - suffix.size(), suffix.size(), suffix) == 0)
+          return true;
+      }
+    }
+  }
+  return false;
+}
+
+#ifdef MI_CPPTEST_HAVE_IMPACT
+
+bool impact_recorder::supported() { return __gcov_dump && __gcov_reset; }
+
+impact_recorder::impact_recorder() : ok_(false) {
+  const char *tmpdir = std::getenv("TMPDIR");
+  std::string path = (tmpdir && *tmpdir) ? tmpdir : "/tmp";
+  path += "/mi-cpptest-impact-XXXXXX";
+  if (!mkdtemp(&path[0])) {
+    std::cerr << "cannot create directory '" << path
+              << "': " << std::strerror(errno) << std::endl;
+    return;
+  }
+  dump_directory_ = absolute_path(path);
+  ok_ = true;
+}
+
+impact_recorder::~impact_recorder() {
+  if (ok_)
+    remove_tree(dump_directory_);
+  // the last __gcov_dump marked the counters as written
+  __gcov_reset();
+}
+
+void impact_recorder::start() { __gcov_reset(); }
+
+const impact_recorder::object_notes &impact_recorder::notes(const std::string &object) {
+  const auto it = notes_.find(object);
+  if (it != notes_.end())
+    return it->second;
+  object_notes &n = notes_[object];
+  std::string gcno;
+  n.ok = read_file(object + ".gcno", gcno) && parse_gcno(gcno, n.function_files);
+  return n;
+}
+
+/*! Source files executed according to one .gcda file.
+ *
+ * `object` is the path of the .gcda file without the suffix, as used
+ * by the compiler.
+ */
+void impact_recorder::executed_files(const std::string &gcda_path, const std::string &object,
+                                     impact_map::files_t &files) {
+  std::string gcda;
+  std::set<uint32_t> executed;
+  const bool gcda_ok = read_file(gcda_path, gcda) && parse_gcda(gcda, executed);
+  if (gcda_ok && executed.empty())
+    return;
+  const object_notes *n = gcda_ok ? &notes(object) : nullptr;
+  if (n && n->ok) {
+    for (uint32_t ident : executed) {
+      const auto it = n->function_files.find(ident);
+      if (it != n->function_files.end())
+        files.insert(it->second.begin(), it->second.end());
+    }
+  } else {
+    // cmake names objects like "CMakeFiles/t.dir/src/x.cc.o", so this will
+    // match relative source paths
+    files.insert(object);
+  }
+}
+
+impact_map::files_t impact_recorder::stop() {
+  if (!ok_)
+    return impact_map::files_t();
+  {
+    environment_override prefix("GCOV_PREFIX", dump_directory_.c_str());
+    environment_override strip("GCOV_PREFIX_STRIP", nullptr);
+    __gcov_dump();
+  }
+
+  std::vector<std::string> gcda_files;
+  found_gcda_files = &gcda_files;
+  nftw(dump_directory_.c_str(), add_gcda_file, 16, FTW_PHYS);
+  found_gcda_files = nullptr;
+
+  impact_map::files_t files;
+  for (const std::string &path : gcda_files) {
+    const std::string object = path.substr(
+        dump_directory_.size(),
+        path.size() - dump_directory_.size() - GCDA_SUFFIX_LENGTH);
+    executed_files(path, object, files);
+  }
+  remove_contents(dump_directory_);
+  return files;
+}
+
+#else // !MI_CPPTEST_HAVE_IMPACT
+
+bool impact_recorder::supported() { return false; }
+
+impact_recorder::impact_recorder() : ok_(false) {}
+
+impact_recorder::~impact_recorder() {}
+
+void impact_recorder::start() {}
+
+impact_map::files_t impact_recorder::stop() { return impact_map::files_t(); }
+
+#endif // !MI_CPPTEST_HAVE_IMPACT
+
+} // namespace cpptest
+} // namespace miutil
@@ -0,0 +1,133 @@
+/* -*- c++ -*-
+  mi-cpptest
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: diana@met.no
+
+  This file is part of mi-cpptest.
+
+  mi-cpptest is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  mi-cpptest is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with mi-cpptest; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MI_CPPTEST_IMPACT_H
+#define MI_CPPTEST_IMPACT_H
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace miutil {
+namespace cpptest {
+
+/*! Source files executed by each test of a program.
+ *
+ * Stored as a text file with one line per test, containing the program
+ * name, the test name and the absolute paths of the source files,
+ * separated by tabs. Entries of other programs are kept, so that several
+ * programs may share a file.
+ */
+class impact_map {
+public:
+  typedef std::set<std::string> files_t;
+
+  //! file name of the running program, empty if unknown
+  static std::string current_program();
+
+  impact_map(const std::string &program) : program_(program) {}
+
+  //! false if the file exists but cannot be read
+  bool read(const std::string &path);
+  bool write(const std::string &path) const;
+
+  void set(const std::string &test, const files_t &files) { tests_[key(test)] = files; }
+
+  /*! True if the test executed one of the changed files, or if no files
+   *  are known for the test.
+   *
+   * Absolute changed paths must match exactly, relative ones may also
+   * match the end of a recorded path.
+   */
+  bool affected(const std::string &test, const std::vector<std::string> &changed) const;
+
+private:
+  typedef std::pair<std::string, std::string> key_t;
+
+  key_t key(const std::string &test) const { return key_t(program_, test); }
+
+  std::string program_;
+  std::map<key_t, files_t> tests_;
+};
+
+/*! Records the source files executed by each test.
+ *
+ * Requires a program built by gcc 9 or later with gcov instrumentation
+ * (`--coverage`) and with `__gcov_dump` and `__gcov_reset` linked in, as
+ * done by the mi-cpptest-gcov CMake target. Counters are reset before each test and
+ * dumped into a private temporary directory after it; functions with non-zero
+ * counters are then looked up in the `.gcno` files from the build, which
+ * are read once for each object. If a file cannot be parsed, the whole
+ * object file counts as executed.
+ *
+ * As the counters are reset for each test, the `.gcda` files written at
+ * program exit do not contain the coverage of the tests.
+ */
+class impact_recorder {
+public:
+  //! false unless the gcov runtime is linked in
+  static bool supported();
+
+  //! creates the dump directory in `$TMPDIR` or `/tmp`
+  impact_recorder();
+
+  //! removes the dump directory and resets the counters, so that the
+  //! gcov runtime writes them at exit
+  ~impact_recorder();
+
+  //! false if the dump directory could not be created
+  bool ok() const { return ok_; }
+
+  void start();
+  impact_map::files_t stop();
+
+private:
+  //! source files of each function, from the `.gcno` file of an object
+  struct object_notes {
+    bool ok;
+    std::map<uint32_t, impact_map::files_t> function_files;
+  };
+
+  const object_notes &notes(const std::string &object);
+  void executed_files(const std::string &gcda_path, const std::string &object,
+                      impact_map::files_t &files);
+
+  std::string dump_directory_;
+  bool ok_;
+  std::map<std::string, object_notes> notes_;
+};
+
+} // namespace cpptest
+} // namespace miutil
+
+#endif // MI_CPPTEST_IMPACT_H
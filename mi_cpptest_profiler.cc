@@ -0,0 +1,460 @@
+/*
+  mi-cpptest
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: diana@met.no
+
+  This file is part of mi-cpptest.
+
+  mi-cpptest is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  mi-cpptest is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with mi-cpptest; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "mi_cpptest_profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#if defined(__linux__) && defined(__GLIBC__)
+#define MI_CPPTEST_HAVE_PROFILER 1
+#endif
+
+#ifdef MI_CPPTEST_HAVE_PROFILER
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <link.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef MI_CPPTEST_HAVE_PROFILER
+
+const size_t TOP_FUNCTIONS = 20;
+
+std::string file_name_for_test(const std::string &test_name) {
+  std::string name = test_name;
+  for (char &ch : name) {
+    if (!((ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') ||
+          (ch >= '0' && ch <= '9') || ch == '_' || ch == '-' || ch == '.'))
+      ch = '_';
+  }
+  return name;
+}
+
+const long SAMPLE_INTERVAL_NS = 1000000;
+const size_t MAX_SAMPLES = 20000;
+const int MAX_DEPTH = 64;
+
+// frames of the signal handler and the signal trampoline
+const int SKIP_FRAMES = 2;
+
+// state shared with the signal handler, allocated by the profiler
+void **sample_frames = nullptr;
+int *sample_depths = nullptr;
+std::atomic<size_t> n_samples(0);
+std::atomic<bool> sampling(false);
+std::atomic<int> in_handler(0);
+
+timer_t sample_timer;
+struct sigaction previous_action;
+
+void on_sigprof(int) {
+  const int saved_errno = errno;
+  in_handler += 1;
+  if (sampling) {
+    const size_t i = n_samples++;
+    if (i < MAX_SAMPLES)
+      sample_depths[i] = backtrace(sample_frames + i * MAX_DEPTH, MAX_DEPTH);
+  }
+  in_handler -= 1;
+  errno = saved_errno;
+}
+
+void set_timer(long interval_ns) {
+  struct itimerspec its;
+  its.it_interval.tv_sec = 0;
+  its.it_interval.tv_nsec = interval_ns;
+  its.it_value = its.it_interval;
+  timer_settime(sample_timer, 0, &its, nullptr);
+}
+
+std::string demangle(const char *name) {
+  int status = 0;
+  std::unique_ptr<char, void (*)(void *)> demangled(
+      abi::__cxa_demangle(name, nullptr, nullptr, &status), std::free);
+  if (status == 0 && demangled)
+    return demangled.get();
+  return name;
+}
+
+// function symbols from the symbol table of a loaded ELF object
+class elf_functions {
+public:
+  elf_functions(const std::string &path, ElfW(Addr) base);
+  const char *find(ElfW(Addr) address) const;
+
+private:
+  struct function {
+    ElfW(Addr) start;
+    ElfW(Xword) size;
+    size_t name;
+  };
+  std::string data_;
+  std::vector<function> functions_;
+};
+
+elf_functions::elf_functions(const std::string &path, ElfW(Addr) base) {
+  std::ifstream in(path, std::ios::binary);
+  std::ostringstream contents;
+  contents << in.rdbuf();
+  data_ = contents.str();
+
+  const size_t size = data_.size();
+  if (size < sizeof(ElfW(Ehdr)))
+    return;
+  const char *data = data_.data();
+  ElfW(Ehdr) ehdr;
+  std::memcpy(&ehdr, data, sizeof(ehdr));
+  if (std::memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 ||
+      ehdr.e_shentsize != sizeof(ElfW(Shdr)) ||
+      ehdr.e_shoff + ehdr.e_shnum * sizeof(ElfW(Shdr)) > size)
+    return;
+
+  std::vector<ElfW(Shdr)> sections(ehdr.e_shnum);
+  std::memcpy(sections.data(), data + ehdr.e_shoff,
+              ehdr.e_shnum * sizeof(ElfW(Shdr)));
+  for (const ElfW(Shdr) &sh : sections) {
+    if (sh.sh_type != SHT_SYMTAB && sh.sh_type != SHT_DYNSYM)
+      continue;
+    if (sh.sh_link >= sections.size() || sh.sh_offset + sh.sh_size > size)
+      continue;
+    const ElfW(Shdr) &strtab = sections[sh.sh_link];
+    if (strtab.sh_offset + strtab.sh_size > size)
+      continue;
+    for (size_t off = 0; off + sizeof(ElfW(Sym)) <= sh.sh_size;
+         off += sizeof(ElfW(Sym))) {
+      ElfW(Sym) sym;
+      std::memcpy(&sym, data + sh.sh_offset + off, sizeof(sym));
+      // symbols without size (e.g. _init) would cover everything up to the
+      // next symbol, like the PLT
+      if (ELF64_ST_TYPE(sym.st_info) != STT_FUNC || sym.st_value == 0 ||
+          sym.st_size == 0 || sym.st_shndx == SHN_UNDEF ||
+          sym.st_name >= strtab.sh_size)
+        continue;
+      functions_.push_back(
+          function{base + sym.st_value, sym.st_size, strtab.sh_offset + sym.st_name});
+    }
+  }
+  std::sort(functions_.begin(), functions_.end(),
+            [](const function &a, const function &b) { return a.start < b.start; });
+}
+
+const char *elf_functions::find(ElfW(Addr) address) const {
+  auto it = std::upper_bound(
+      functions_.begin(), functions_.end(), address,
+      [](ElfW(Addr) a, const function &f) { return a < f.start; });
+  if (it == functions_.begin())
+    return nullptr;
+  --it;
+  if (address >= it->start + it->size)
+    return nullptr;
+  return data_.data() + it->name;
+}
+
+struct loaded_object {
+  std::string path;
+  ElfW(Addr) base;
+  std::vector<std::pair<ElfW(Addr), ElfW(Addr)>> segments;
+  std::shared_ptr<elf_functions> functions;
+};
+
+int add_loaded_object(struct dl_phdr_info *info, size_t, void *data) {
+  std::vector<loaded_object> &objects = *static_cast<std::vector<loaded_object> *>(data);
+  loaded_object lo;
+  lo.path = info->dlpi_name;
+  if (lo.path.empty()) {
+    if (!objects.empty())
+      return 0; // vdso
+    char exe[4096];
+    const ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    lo.path = (n > 0) ? std::string(exe, n) : "/proc/self/exe";
+  }
+  lo.base = info->dlpi_addr;
+  for (int i = 0; i < info->dlpi_phnum; ++i) {
+    const ElfW(Phdr) &ph = info->dlpi_phdr[i];
+    if (ph.p_type == PT_LOAD)
+      lo.segments.push_back(std::make_pair(lo.base + ph.p_vaddr, lo.base + ph.p_vaddr + ph.p_memsz));
+  }
+  objects.push_back(lo);
+  return 0;
+}
+
+std::vector<loaded_object> &loaded_objects() {
+  static std::vector<loaded_object> objects;
+  return objects;
+}
+
+loaded_object *find_loaded_object(ElfW(Addr) address) {
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    std::vector<loaded_object> &objects = loaded_objects();
+    for (loaded_object &lo : objects) {
+      for (const auto &s : lo.segments) {
+        if (address >= s.first && address < s.second)
+          return &lo;
+      }
+    }
+    // maybe loaded since the last call
+    objects.clear();
+    dl_iterate_phdr(add_loaded_object, &objects);
+  }
+  return nullptr;
+}
+
+#endif // MI_CPPTEST_HAVE_PROFILER
+
+} // namespace
+
+namespace miutil {
+namespace cpptest {
+
+#ifdef MI_CPPTEST_HAVE_PROFILER
+
+bool sampling_profiler::supported() { return true; }
+
+sampling_profiler::sampling_profiler(const std::string &directory)
+    : directory_(directory), ok_(false), have_handler_(false),
+      have_timer_(false) {
+  if (mkdir(directory_.c_str(), 0777) != 0 && errno != EEXIST) {
+    std::cerr << "cannot create profile directory '" << directory_
+              << "': " << std::strerror(errno) << std::endl;
+    return;
+  }
+
+  sample_frames = new void *[MAX_SAMPLES * MAX_DEPTH];
+  sample_depths = new int[MAX_SAMPLES];
+
+  // backtrace may allocate on first use, which is not allowed in a signal
+  // handler
+  void *frame;
+  backtrace(&frame, 1);
+
+  struct sigaction sa;
+  std::memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_sigprof;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  if (sigaction(SIGPROF, &sa, &previous_action) != 0) {
+    std::cerr << "cannot install SIGPROF handler: " << std::strerror(errno)
+              << std::endl;
+    return;
+  }
+  have_handler_ = true;
+
+  struct sigevent sev;
+  std::memset(&sev, 0, sizeof(sev));
+  sev.sigev_notify = SIGEV_SIGNAL;
+  sev.sigev_signo = SIGPROF;
+  if (timer_create(CLOCK_PROCESS_CPUTIME_ID, &sev, &sample_timer) != 0) {
+    std::cerr << "cannot create CPU time timer: " << std::strerror(errno)
+              << std::endl;
+    return;
+  }
+  have_timer_ = true;
+  ok_ = true;
+}
+
+sampling_profiler::~sampling_profiler() {
+  stop();
+  if (have_timer_)
+    timer_delete(sample_timer);
+  if (have_handler_)
+    sigaction(SIGPROF, &previous_action, nullptr);
+  delete[] sample_frames;
+  delete[] sample_depths;
+  sample_frames = nullptr;
+  sample_depths = nullptr;
+}
+
+void sampling_profiler::start() {
+  if (!ok_)
+    return;
+  n_samples = 0;
+  sampling = true;
+  set_timer(SAMPLE_INTERVAL_NS);
+}
+
+void sampling_profiler::stop() {
+  if (!ok_)
+    return;
+  set_timer(0);
+  sampling = false;
+  while (in_handler > 0) {
+  }
+}
+
+const std::string &sampling_profiler::symbol_name(void *address) {
+  auto it = symbols_.find(address);
+  if (it != symbols_.end())
+    return it->second;
+
+  std::string name;
+  const ElfW(Addr) a = reinterpret_cast<ElfW(Addr)>(address);
+  if (loaded_object *lo = find_loaded_object(a)) {
+    if (!lo->functions)
+      lo->functions = std::make_shared<elf_functions>(lo->path, lo->base);
+    if (const char *fn = lo->functions->find(a)) {
+      name = demangle(fn);
+    } else {
+      // e.g. PLT or stripped code; one name per object, not per address
+      const size_t slash = lo->path.rfind('/');
+      name = "[" + lo->path.substr(slash == std::string::npos ? 0 : slash + 1) + "]";
+    }
+  } else {
+    name = "[unknown]";
+  }
+  // ';' separates frames in folded stacks
+  std::replace(name.begin(), name.end(), ';', ':');
+  return symbols_.insert(std::make_pair(address, name)).first->second;
+}
+
+bool sampling_profiler::write(const std::string &test_name) {
+  if (!ok_)
+    return true;
+  const size_t total = n_samples;
+  const size_t n = std::min(total, MAX_SAMPLES);
+
+  std::map<std::string, size_t> stacks;
+  std::map<std::string, function_samples> functions;
+  std::vector<const std::string *> frames;
+  for (size_t i = 0; i < n; ++i) {
+    void **sf = sample_frames + i * MAX_DEPTH;
+    frames.clear();
+    // innermost first; return addresses point after the call
+    for (int d = SKIP_FRAMES; d < sample_depths[i]; ++d) {
+      char *address = static_cast<char *>(sf[d]);
+      if (d > SKIP_FRAMES)
+        address -= 1;
+      frames.push_back(&symbol_name(address));
+    }
+    // drop the runner or test_thread and everything calling them
+    for (size_t f = 0; f < frames.size(); ++f) {
+      if (frames[f]->compare(0, 27, "miutil::cpptest::run_tests(") == 0 ||
+          frames[f]->compare(0, 30, "miutil::cpptest::test_thread::") == 0) {
+        frames.resize(f);
+        break;
+      }
+    }
+    if (frames.empty())
+      continue;
+
+    std::string stack;
+    for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+      if (!stack.empty())
+        stack += ';';
+      stack += **it;
+    }
+    stacks[stack] += 1;
+
+    functions[*frames.front()].self += 1;
+    std::vector<const std::string *> seen;
+    for (const std::string *f : frames) {
+      if (std::find(seen.begin(), seen.end(), f) == seen.end()) {
+        functions[*f].total += 1;
+        seen.push_back(f);
+      }
+    }
+  }
+
+  test_summary summary;
+  summary.name = test_name;
+  summary.samples = n;
+  summary.dropped = total - n;
+  summary.top.assign(functions.begin(), functions.end());
+  std::sort(summary.top.begin(), summary.top.end(),
+            [](const std::pair<std::string, function_samples> &a,
+               const std::pair<std::string, function_samples> &b) {
+              if (a.second.self != b.second.self)
+                return a.second.self > b.second.self;
+              return a.second.total > b.second.total;
+            });
+  if (summary.top.size() > TOP_FUNCTIONS)
+    summary.top.resize(TOP_FUNCTIONS);
+  summaries_.push_back(summary);
+
+  std::ofstream out(directory_ + "/" + file_name_for_test(test_name) + ".folded");
+  for (const auto &s : stacks)
+    out << s.first << ' ' << s.second << '\n';
+  return static_cast<bool>(out);
+}
+
+#else // !MI_CPPTEST_HAVE_PROFILER
+
+bool sampling_profiler::supported() { return false; }
+
+sampling_profiler::sampling_profiler(const std::string &directory)
+    : directory_(directory), ok_(false), have_handler_(false),
+      have_timer_(false) {}
+
+sampling_profiler::~sampling_profiler() {}
+
+void sampling_profiler::start() {}
+
+void sampling_profiler::stop() {}
+
+bool sampling_profiler::write(const std::string &) { return true; }
+
+#endif // !MI_CPPTEST_HAVE_PROFILER
+
+bool sampling_profiler::write_summary() {
+  std::ofstream out(directory_ + "/profile-summary.txt");
+  for (const test_summary &s : summaries_) {
+    out << s.name << ": " << s.samples << " samples";
+    if (s.dropped > 0)
+      out << " (" << s.dropped << " dropped)";
+    out << '\n';
+    if (!s.top.empty()) {
+      out << "     self    total  function\n";
+      for (const auto &f : s.top) {
+        out.width(9);
+        out << f.second.self;
+        out.width(9);
+        out << f.second.total;
+        out << "  " << f.first << '\n';
+      }
+    }
+    out << '\n';
+  }
+  return static_cast<bool>(out);
+}
+
+} // namespace cpptest
+} // namespace miutil
@@ -0,0 +1,99 @@
+/* -*- c++ -*-
+  mi-cpptest
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: diana@met.no
+
+  This file is part of mi-cpptest.
+
+  mi-cpptest is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  mi-cpptest is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with mi-cpptest; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MI_CPPTEST_PROFILER_H
+#define MI_CPPTEST_PROFILER_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace miutil {
+namespace cpptest {
+
+/*! CPU time sampling profiler for the tests run by run_tests.
+ *
+ * Samples the stacks of all threads of the process with SIGPROF from a
+ * CPU time timer and backtrace(). For each test, write() creates a file
+ * `<test>.folded` with one line per distinct stack as expected by
+ * flamegraph.pl, and write_summary() creates `profile-summary.txt` with
+ * the functions having most samples in each test.
+ *
+ * Only one profiler may exist at a time.
+ */
+class sampling_profiler {
+public:
+  //! false if sampling is not implemented for this platform
+  static bool supported();
+
+  sampling_profiler(const std::string &directory);
+  ~sampling_profiler();
+
+  sampling_profiler(const sampling_profiler &) = delete;
+  sampling_profiler &operator=(const sampling_profiler &) = delete;
+
+  //! false if the directory, signal handler or timer could not be set up
+  bool ok() const { return ok_; }
+
+  void start();
+  void stop();
+
+  //! write the samples since start() for this test
+  bool write(const std::string &test_name);
+
+  bool write_summary();
+
+private:
+  struct function_samples {
+    size_t self;
+    size_t total;
+  };
+  struct test_summary {
+    std::string name;
+    size_t samples;
+    size_t dropped;
+    std::vector<std::pair<std::string, function_samples>> top;
+  };
+
+  const std::string &symbol_name(void *address);
+
+  std::string directory_;
+  bool ok_;
+  bool have_handler_;
+  bool have_timer_;
+  std::map<void *, std::string> symbols_;
+  std::vector<test_summary> summaries_;
+};
+
+} // namespace cpptest
+} // namespace miutil
+
+#endif // MI_CPPTEST_PROFILER_H
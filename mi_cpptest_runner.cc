@@ -0,0 +1,83 @@
+/*
+  mi-cpptest
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: diana@met.no
+
+  This file is part of mi-cpptest.
+
+  mi-cpptest is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  mi-cpptest is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with mi-cpptest; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// Loads test modules, i.e. shared objects with tests, and runs their tests.
+//
+// Usage: mi-cpptest-runner MODULE... [-- ARGUMENT...]
+//
+// Tests are named "{module}/{test}", where {module} is the file name of
+// the module without directory, "lib" prefix and extension. ARGUMENTs
+// are filters and options as for other test programs.
+
+#include "mi_cpptest.h"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <dlfcn.h>
+
+namespace {
+
+std::string module_name(const std::string &path)
+{
+    std::string name = path.substr(path.rfind('/') + 1);
+    if (name.compare(0, 3, "lib") == 0)
+        name = name.substr(3);
+    const size_t dot = name.find('.');
+    if (dot != std::string::npos)
+        name = name.substr(0, dot);
+    return name;
+}
+
+} // namespace
+
+int main(int argc, char* args[])
+{
+    int a = 1;
+    for (; a < argc; ++a) {
+        if (std::strcmp(args[a], "--") == 0) {
+            a += 1;
+            break;
+        }
+        std::string path = args[a];
+        miutil::cpptest::set_test_name_prefix(module_name(path) + "/");
+        // dlopen searches the library path for names without '/'
+        if (path.find('/') == std::string::npos)
+            path = "./" + path;
+        // never closed, as the tests are run later
+        if (!dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL)) {
+            std::cerr << "cannot load test module: " << dlerror() << std::endl;
+            return 1;
+        }
+    }
+    miutil::cpptest::set_test_name_prefix(std::string());
+
+    return miutil::cpptest::run_tests(argc - a, args + a) ? 0 : 1;
+}
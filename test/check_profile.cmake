@@ -0,0 +1,35 @@
+# mi-cpptest
+#
+# Copyright (C) 2026 met.no
+#
+# Contact information:
+# Norwegian Meteorological Institute
+# Box 43 Blindern
+# 0313 OSLO
+# NORWAY
+# email: diana@met.no
+#
+# This file is part of mi-cpptest.
+#
+# mi-cpptest is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# mi-cpptest is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with mi-cpptest; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+# checks that a folded stack file from --profile contains a function
+# usage: cmake -DFOLDED=file -DFUNCTION=name -P check_profile.cmake
+
+FILE(READ "${FOLDED}" folded)
+STRING(FIND "${folded}" "${FUNCTION}" found)
+IF(found EQUAL -1)
+  MESSAGE(FATAL_ERROR "'${FUNCTION}' not found in '${FOLDED}':\n${folded}")
+ENDIF()
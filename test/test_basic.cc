@@ -30,6 +30,7 @@
 
 #include "mi_cpptest.h"
 
+#include <iomanip>
 #include <map>
 #include <ostream>
 #include <sstream>
@@ -122,3 +123,50 @@ MI_CPPTEST_TEST_CASE(test_type_with_ostream_and_stringify) {
 
   MI_CPPTEST_REQUIRE_EQ(act, "stringify");
 }
+
+MI_CPPTEST_TEST_CASE(test_stringify_numbers) {
+  std::ostringstream out;
+  out << miutil::cpptest::stringify(0.1) << ' '
+      << miutil::cpptest::stringify(1.0 / 3) << ' '
+      << miutil::cpptest::stringify(0.1f) << ' '
+      << miutil::cpptest::stringify(-17) << ' '
+      << miutil::cpptest::stringify(std::vector<double>{0.5, 1e-20});
+  MI_CPPTEST_REQUIRE_EQ(out.str(), "0.1 0.3333333333333333 0.1 -17 {0.5,1e-20}");
+}
+
+MI_CPPTEST_TEST_CASE(test_stringify_number_stream_format) {
+  std::ostringstream out;
+  out << std::setprecision(3) << miutil::cpptest::stringify(1.0 / 3);
+  MI_CPPTEST_REQUIRE_EQ(out.str(), "0.333");
+}
+
+MI_CPPTEST_TEST_CASE(test_formatter) {
+  miutil::cpptest::formatter f;
+  f << "x=" << miutil::cpptest::stringify(std::make_pair(1, 2.5)) << ' '
+    << miutil::cpptest::stringify(Stringify{7}) << ' '
+    << miutil::cpptest::stringify(OstreamAndStringify{7}) << ' '
+    << miutil::cpptest::stringify(NoOstream{}) << ' ' << true;
+  {
+    miutil::cpptest::formatter nested;
+    nested << "nested";
+    MI_CPPTEST_CHECK_EQ(nested.str(), "nested");
+  }
+  f << ' ' << std::setprecision(3) << 1.0 / 3;
+  MI_CPPTEST_REQUIRE_EQ(f.str(), "x=<1,2.5> stringify stringify ??? 1 0.333");
+}
+
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef __int128 int128_t;
+
+MI_CPPTEST_TEST_CASE(test_stringify_int128) {
+  static_assert(!miutil::cpptest::is_formatted_number<int128_t>::value,
+                "__int128 must not be truncated to long long");
+  std::ostringstream oact;
+  oact << miutil::cpptest::stringify(int128_t(5));
+
+  std::ostringstream exp;
+  miutil::cpptest::mi_cpptest_stringify_missing(exp);
+
+  MI_CPPTEST_REQUIRE_EQ(oact.str(), exp.str());
+}
+#endif
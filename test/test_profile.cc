@@ -0,0 +1,54 @@
+/*
+  mi-cpptest
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: diana@met.no
+
+  This file is part of mi-cpptest.
+
+  mi-cpptest is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  mi-cpptest is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with mi-cpptest; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "mi_cpptest.h"
+
+#include <ctime>
+
+namespace {
+
+volatile double sink;
+
+// uses about 200ms of CPU time, enough for many 1ms profiler samples
+__attribute__((noinline)) void profile_busy_loop() {
+  const std::clock_t end = std::clock() + CLOCKS_PER_SEC / 5;
+  double s = 0;
+  while (std::clock() < end) {
+    for (int i = 0; i < 10000; ++i)
+      s += i * 0.5;
+  }
+  sink = s;
+}
+
+} // namespace
+
+MI_CPPTEST_TEST_CASE(test_profile_busy) {
+  profile_busy_loop();
+  MI_CPPTEST_CHECK(sink != 0);
+}
@@ -0,0 +1,112 @@
+/*
+  mi-cpptest
+
+  Copyright (C) 2026 met.no
+
+  Contact information:
+  Norwegian Meteorological Institute
+  Box 43 Blindern
+  0313 OSLO
+  NORWAY
+  email: diana@met.no
+
+  This file is part of mi-cpptest.
+
+  mi-cpptest is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  mi-cpptest is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with mi-cpptest; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "mi_cpptest.h"
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+MI_CPPTEST_TEST_CASE(test_thread_checks_pass) {
+  std::vector<std::unique_ptr<miutil::cpptest::test_thread>> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back(new miutil::cpptest::test_thread(mi_cpptest_recorder, [&] {
+      for (int i = 0; i < 10000; ++i)
+        MI_CPPTEST_CHECK_EQ(i, i);
+    }));
+  }
+  for (auto &t : threads)
+    t->join();
+}
+
+MI_CPPTEST_TEST_CASE(test_thread_checks_merged) {
+  miutil::cpptest::test_recorder tr;
+  {
+    std::vector<std::unique_ptr<miutil::cpptest::test_thread>> threads;
+    for (int t = 3; t >= 0; --t) {
+      threads.emplace_back(new miutil::cpptest::test_thread(&tr, [t] {
+        miutil::cpptest::test_recorder *mi_cpptest_recorder =
+            miutil::cpptest::test_recorder::current();
+        MI_CPPTEST_CHECK_MESSAGE(false, "thread " << t << " first");
+        MI_CPPTEST_CHECK_MESSAGE(false, "thread " << t << " second");
+      }));
+    }
+  }
+  MI_CPPTEST_CHECK_EQ(miutil::cpptest::FAIL, tr.status());
+  MI_CPPTEST_CHECK(tr.messages().empty());
+
+  tr.finish();
+  MI_CPPTEST_REQUIRE_EQ(8, tr.messages().size());
+  for (size_t i = 0; i < 8; ++i) {
+    const std::string &m = tr.messages()[i];
+    const std::string exp = "thread " + std::to_string(i / 2) +
+                            ((i % 2) == 0 ? " first" : " second");
+    MI_CPPTEST_CHECK_EQ(exp, m.substr(m.size() - exp.size()));
+  }
+  MI_CPPTEST_CHECK(!tr.aborted());
+}
+
+MI_CPPTEST_TEST_CASE(test_thread_require_aborts) {
+  miutil::cpptest::test_recorder tr;
+  bool reached = false;
+  miutil::cpptest::test_thread t(&tr, [&] {
+    miutil::cpptest::test_recorder *mi_cpptest_recorder = &tr;
+    MI_CPPTEST_REQUIRE(false);
+    reached = true;
+  });
+  MI_CPPTEST_CHECK_THROW(t.join(), miutil::cpptest::test_failure);
+  MI_CPPTEST_CHECK(!reached);
+  MI_CPPTEST_CHECK(tr.aborted());
+
+  tr.finish();
+  MI_CPPTEST_CHECK_EQ(1, tr.messages().size());
+}
+
+MI_CPPTEST_TEST_CASE(test_thread_exception_aborts) {
+  miutil::cpptest::test_recorder tr;
+  miutil::cpptest::test_thread t(&tr, [] { throw std::runtime_error("oops"); });
+  MI_CPPTEST_CHECK_THROW(t.join(), miutil::cpptest::test_failure);
+
+  tr.finish();
+  MI_CPPTEST_REQUIRE_EQ(1, tr.messages().size());
+  MI_CPPTEST_CHECK_EQ("uncaught exception: oops", tr.messages().front());
+}
+
+MI_CPPTEST_TEST_CASE(test_current_recorder) {
+  MI_CPPTEST_CHECK_EQ(mi_cpptest_recorder,
+                      miutil::cpptest::test_recorder::current());
+
+  miutil::cpptest::test_recorder *in_std_thread = nullptr;
+  std::thread t([&] { in_std_thread = miutil::cpptest::test_recorder::current(); });
+  t.join();
+  MI_CPPTEST_CHECK_EQ(mi_cpptest_recorder, in_std_thread);
+}